@@ -18,6 +18,7 @@ int mqtt_client_init(mqttClient *client, char* brokerURL, int portNumber, char*
     client->willRetainMessage = false;
     client->willQos = 0;
     client->keepAlive = defaultKeepAlive;
+    client->cache = NULL; // the cache is disabled, mqtt_client_cache_enable() must be called after init
     // set the private setup of the broker
     memset(&client->__brokerAddr, 0, sizeof(client->__brokerAddr));
     client->__brokerAddr.sin_family = AF_INET;
@@ -303,63 +304,270 @@ int mqtt_client_connect(mqttClient *client){
     return mqtt_client_connect_adavance(client, true, defaultKeepAlive);
 }
 
+// publish a message to a topic.
+// The fixed header, the remaining length and the topic length are built in a small buffer on the stack and sent with the caller's topic and message
+// in one lwip_writev(), so there is no per-message heap allocation or intermediate packet buffer.
 int mqtt_client_publish(mqttClient *client, char *topic, char *message, int Qos){
     if(client->__state == MQTT_CONNECTED){
     //******** Fixed header ********//
-        int fixed_headerLen = 2;
-        uint8_t fixed_header[2];
-        fixed_header[0] = publishHeader;
-        
+        // 1 byte for the message type and flags + up to 4 bytes for the remaining length + 2 bytes for the topic name length (start of the variable header)
+        uint8_t header[7];
+        int headerLen = 0;
+        header[headerLen] = publishHeader;
+
         switch (Qos){
         case 0:
-            fixed_header[0] |= qos0Flag;
+            header[headerLen] |= qos0Flag;
             break;
-        
+
         default:
             perror("Unknow QoS are used to publish a message");
             return -1;
             break;
         }
+        headerLen++;
 
         //******** Variable header ********//
-        int variable_headerLen = strlen(topic) + 2 ; // 2 topic name length in 2 byte + length of the topic name. (note: if QoS > 0 then the variable header will include another information which is the message id in 2 byte at the end of the variable header)
-        uint8_t* variable_header = malloc(sizeof(uint8_t)*variable_headerLen);
+        // topic name length (2 bytes) + topic name. (note: if QoS > 0 then the variable header will include another information which is the message id in 2 byte at the end of the variable header)
+        size_t topicLen = strlen(topic);
+        if(topicLen > 0xFFFF){
+            perror("Topic is too long");
+            return -1;
+        }
+        //******** payload ********//
+        size_t payloadLen = strlen(message);
+        // Remaining length (variable header + payload), encoded on 1 to 4 bytes: 7 bits per byte and bit 7 set when another byte follows
+        uint32_t remainingLen = 2 + topicLen + payloadLen;
+        if(remainingLen > 268435455UL){
+            perror("Message is too long");
+            return -1;
+        }
+        do{
+            uint8_t encodedByte = remainingLen % 128;
+            remainingLen /= 128;
+            if(remainingLen > 0){
+                encodedByte |= 0x80;
+            }
+            header[headerLen++] = encodedByte;
+        }while(remainingLen > 0);
         // Topic name length (2bytes)
-        variable_header[0] = (variable_headerLen-2) >> 8;
-        variable_header[1] = (variable_headerLen-2) & 0x00ff;
-        // Topic name
-        for(int i=0; i<variable_headerLen-2; i++){
-            variable_header[i+2] = topic[i];
+        header[headerLen++] = topicLen >> 8;
+        header[headerLen++] = topicLen & 0x00ff;
+
+        //******** send the whole packet to broker ********//
+        struct iovec packet[3];
+        packet[0].iov_base = header;
+        packet[0].iov_len = headerLen;
+        packet[1].iov_base = topic;
+        packet[1].iov_len = topicLen;
+        packet[2].iov_base = message;
+        packet[2].iov_len = payloadLen;
+        if(lwip_writev(client->__client_socket_file_descriptor, packet, 3) < 0){
+            perror("Sending publish request failed: ");
+            return -1;
         }
-        // Message id
-        variable_header[variable_headerLen-1] = availableMessageId >> 8;
-        variable_header[variable_headerLen] = availableMessageId & 0x00ff;
+        client->__lastActiveTime = millis();
+        return 0;
+    }
+    return -1;
+}
 
-        //******** payload ********//
-        // I just sacrificed 2 character from the max length of the client id to use the unsigned int of 16 bits type for the payloadLen var. I guess it won't make a big difference.
-        uint16_t payloadLen = strlen(message);
-        uint8_t* payload = malloc(sizeof(uint8_t)*(payloadLen));
-        memcpy(payload, message, payloadLen * sizeof(uint8_t));
-        // Remaining length 
-        fixed_header[1] = variable_headerLen + payloadLen;
+//**************************************************************************** Last value cache ****************************************************************************//
+// FNV-1a hash of the topic
+static uint32_t mqtt_cache_hash(const char *topic){
+    uint32_t hash = 2166136261UL;
+    while(*topic){
+        hash ^= (uint8_t)*topic++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
 
-        //******** create the whole packet to send to broker ********//
-        int packetLen = fixed_headerLen + variable_headerLen + payloadLen;
-        uint8_t* packet = malloc(sizeof(uint8_t)*packetLen);
-        for(int i=0; i<packetLen; i++){
-            if(i<fixed_headerLen){
-            packet[i] = fixed_header[i];
-            }else if(i<(fixed_headerLen+variable_headerLen)){
-            packet[i] = variable_header[i-fixed_headerLen];
-            }else{
-            packet[i] = payload[i-(fixed_headerLen+variable_headerLen)];
+// find the slot of the topic, if the topic isn't in the cache and insert is true then take the first empty slot for it.
+// return the slot index or -1 if the topic isn't found (or the cache is full)
+static int mqtt_cache_find(mqttCache *cache, const char *topic, bool insert){
+    uint32_t index = mqtt_cache_hash(topic) & (MQTT_CACHE_SLOTS - 1);
+    for(int i=0; i<MQTT_CACHE_SLOTS; i++){
+        mqttCacheEntry *entry = &cache->entries[index];
+        if(!entry->used){
+            // topics are never removed so the first empty slot is the end of the probe sequence
+            if(!insert){
+                return -1;
             }
+            entry->used = true;
+            entry->hasValue = false;
+            strcpy(entry->topic, topic);
+            entry->version = 0;
+            entry->lastUsed = 0;
+            return index;
         }
-        if(lwip_write(client->__client_socket_file_descriptor, packet, sizeof(uint8_t)*packetLen) < 0){
-            perror("Sending connetion request failed: ");
-            return -1;
+        if(strcmp(entry->topic, topic) == 0){
+            return index;
         }
-        return 0;
+        index = (index + 1) & (MQTT_CACHE_SLOTS - 1);
     }
     return -1;
-}
\ No newline at end of file
+}
+
+// drop the payload of the least recently used entry. return -1 if there is no payload to drop
+static int mqtt_cache_evict(mqttCache *cache){
+    int lru = -1;
+    for(int i=0; i<MQTT_CACHE_SLOTS; i++){
+        mqttCacheEntry *entry = &cache->entries[i];
+        if(entry->hasValue && (lru < 0 || (int32_t)(entry->lastUsed - cache->entries[lru].lastUsed) < 0)){
+            lru = i;
+        }
+    }
+    if(lru < 0){
+        return -1;
+    }
+    cache->entries[lru].hasValue = false;
+    cache->entries[lru].version++;
+    cache->arenaUsed -= cache->entries[lru].payloadLen;
+    return 0;
+}
+
+// move all the stored payloads to the beginning of the arena to get back the space left by the evicted ones
+static void mqtt_cache_compact(mqttCache *cache){
+    uint16_t top = 0;
+    // empty payloads take no space in the arena, they are only moved to the beginning so they don't stop the loop below on the same offset
+    for(int i=0; i<MQTT_CACHE_SLOTS; i++){
+        if(cache->entries[i].hasValue && cache->entries[i].payloadLen == 0){
+            cache->entries[i].payloadOffset = 0;
+        }
+    }
+    // payloads are moved in the order of their position so a payload never overwrite one that is not moved yet
+    while(top < cache->arenaUsed){
+        int next = -1;
+        for(int i=0; i<MQTT_CACHE_SLOTS; i++){
+            mqttCacheEntry *entry = &cache->entries[i];
+            if(entry->hasValue && entry->payloadLen > 0 && entry->payloadOffset >= top && (next < 0 || entry->payloadOffset < cache->entries[next].payloadOffset)){
+                next = i;
+            }
+        }
+        mqttCacheEntry *entry = &cache->entries[next];
+        memmove(&cache->arena[top], &cache->arena[entry->payloadOffset], entry->payloadLen);
+        entry->payloadOffset = top;
+        top += entry->payloadLen;
+    }
+    cache->arenaTop = top;
+    cache->generation++;
+}
+
+// enable the last value cache for this client. the cache memory is given by the user (static or global variable) so the library doesn't allocate it.
+int mqtt_client_cache_enable(mqttClient *client, mqttCache *cache){
+    if(cache == NULL){
+        perror("Cache must not be Null");
+        return -1;
+    }
+    memset(cache, 0, sizeof(mqttCache));
+    client->cache = cache;
+    return 0;
+}
+
+// reserve a slot in the cache for a concrete topic (no wildcards) and return its handle to use with mqtt_client_cache_version() and mqtt_client_cache_peek()
+int mqtt_client_cache_prepare(mqttClient *client, char *topic){
+    if(client->cache == NULL){
+        perror("Cache is not enabled");
+        return -1;
+    }
+    if(topic == NULL || strcmp(topic,"") == 0 || strlen(topic) >= MQTT_CACHE_TOPIC_MAX_LEN){
+        perror("Cache topic must not be empty or longer than MQTT_CACHE_TOPIC_MAX_LEN");
+        return -1;
+    }
+    if(strchr(topic, '+') != NULL || strchr(topic, '#') != NULL){
+        perror("Cache topic must not have wildcards");
+        return -1;
+    }
+    int handle = mqtt_cache_find(client->cache, topic, true);
+    if(handle < 0){
+        perror("Cache is full");
+    }
+    return handle;
+}
+
+// store the latest payload received for a topic. It's called with the message of each publish received from the broker for a subscribed topic.
+// only the topics reserved with mqtt_client_cache_prepare() are stored, the other ones (for example topics matched by a wildcard subscription) are ignored.
+// return the handle of the topic or -1 if the payload isn't stored
+int mqtt_client_cache_update(mqttClient *client, char *topic, uint8_t *payload, size_t payloadLen){
+    mqttCache *cache = client->cache;
+    if(cache == NULL || topic == NULL){
+        return -1;
+    }
+    if(payloadLen > MQTT_CACHE_ARENA_SIZE){
+        perror("Payload is bigger than the cache");
+        return -1;
+    }
+    int handle = mqtt_cache_find(cache, topic, false);
+    if(handle < 0){
+        return -1;
+    }
+    mqttCacheEntry *entry = &cache->entries[handle];
+    // the old payload is replaced so its space is free
+    if(entry->hasValue){
+        entry->hasValue = false;
+        cache->arenaUsed -= entry->payloadLen;
+    }
+    // evict the least recently used payloads until the new one fit in the byte budget
+    while(cache->arenaUsed + payloadLen > MQTT_CACHE_ARENA_SIZE){
+        mqtt_cache_evict(cache);
+    }
+    if(cache->arenaTop + payloadLen > MQTT_CACHE_ARENA_SIZE){
+        mqtt_cache_compact(cache);
+    }
+    memcpy(&cache->arena[cache->arenaTop], payload, payloadLen);
+    entry->payloadOffset = cache->arenaTop;
+    entry->payloadLen = (uint16_t)payloadLen;
+    entry->hasValue = true;
+    entry->version++;
+    entry->lastUsed = ++cache->tick;
+    cache->arenaTop += payloadLen;
+    cache->arenaUsed += payloadLen;
+    cache->generation++;
+    return handle;
+}
+
+// return the version of the payload of this handle (0 if no payload was received yet). It change when a new payload is stored and when the payload is evicted,
+// so readers can poll it to know when the value of a topic has changed. It doesn't tell if a pointer returned by mqtt_client_cache_peek() is still valid,
+// use mqtt_client_cache_generation() for that.
+uint32_t mqtt_client_cache_version(mqttClient *client, int handle){
+    if(client->cache == NULL || handle < 0 || handle >= MQTT_CACHE_SLOTS){
+        return 0;
+    }
+    return client->cache->entries[handle].version;
+}
+
+// return the generation of the cache. It change each time a payload is stored or payloads are moved in the arena,
+// a pointer returned by mqtt_client_cache_peek() is valid only as long as the generation is the same as when the pointer was returned.
+uint32_t mqtt_client_cache_generation(mqttClient *client){
+    if(client->cache == NULL){
+        return 0;
+    }
+    return client->cache->generation;
+}
+
+// return a pointer to the latest payload of this handle without copying it, or Null if there is no payload (never received or evicted).
+// the pointer is valid only while mqtt_client_cache_generation() doesn't change (in practice until the next mqtt_client_cache_update() that stores a payload).
+const uint8_t* mqtt_client_cache_peek(mqttClient *client, int handle, uint16_t *payloadLen, uint32_t *version){
+    if(payloadLen != NULL){
+        *payloadLen = 0;
+    }
+    if(version != NULL){
+        *version = 0;
+    }
+    if(client->cache == NULL || handle < 0 || handle >= MQTT_CACHE_SLOTS){
+        return NULL;
+    }
+    mqttCacheEntry *entry = &client->cache->entries[handle];
+    if(version != NULL){
+        *version = entry->version;
+    }
+    if(!entry->hasValue){
+        return NULL;
+    }
+    entry->lastUsed = ++client->cache->tick;
+    if(payloadLen != NULL){
+        *payloadLen = entry->payloadLen;
+    }
+    return &client->cache->arena[entry->payloadOffset];
+}
@@ -57,6 +57,54 @@
 #define MQTT_CONNECT_UNAUTHORIZED -9
 #endif
 
+//***** Last value cache *****//
+// Number of topics the cache can hold (must be a power of 2 because it's used as a mask in the hash table)
+#ifndef MQTT_CACHE_SLOTS
+#define MQTT_CACHE_SLOTS 16
+#endif
+// Maximum length of a cached topic (including the '\0')
+#ifndef MQTT_CACHE_TOPIC_MAX_LEN
+#define MQTT_CACHE_TOPIC_MAX_LEN 64
+#endif
+// Size in bytes of the arena where the payloads are stored, it's the byte budget of the cache. Least recently used payloads are evicted when it's full
+#ifndef MQTT_CACHE_ARENA_SIZE
+#define MQTT_CACHE_ARENA_SIZE 1024
+#endif
+
+#if MQTT_CACHE_SLOTS <= 0 || (MQTT_CACHE_SLOTS & (MQTT_CACHE_SLOTS - 1)) != 0
+#error "MQTT_CACHE_SLOTS must be a power of 2"
+#endif
+// offsets and sizes in the arena are stored in 16 bits
+#if MQTT_CACHE_ARENA_SIZE <= 0 || MQTT_CACHE_ARENA_SIZE > UINT16_MAX
+#error "MQTT_CACHE_ARENA_SIZE must be between 1 and UINT16_MAX"
+#endif
+
+// One entry of the cache. The topic stay in its slot once it's prepared so the handle returned by mqtt_client_cache_prepare() is valid as long as the cache exist,
+// only the payload can be evicted.
+typedef struct mqttCacheEntry mqttCacheEntry;
+
+struct mqttCacheEntry{
+    bool used; // the slot has a topic
+    bool hasValue; // a payload is stored in the arena for this topic
+    char topic[MQTT_CACHE_TOPIC_MAX_LEN];
+    uint16_t payloadOffset; // position of the payload in the arena
+    uint16_t payloadLen;
+    uint32_t version; // incremented each time the payload change (new payload or evicted), 0 mean no payload was received yet
+    uint32_t lastUsed; // value of the cache tick when the payload was last stored or read (for the LRU eviction)
+};
+
+// Fixed size open addressing hash table (linear probing) with an arena for the payloads.
+typedef struct mqttCache mqttCache;
+
+struct mqttCache{
+    mqttCacheEntry entries[MQTT_CACHE_SLOTS];
+    uint8_t arena[MQTT_CACHE_ARENA_SIZE];
+    uint16_t arenaTop; // first free byte at the end of the arena
+    uint16_t arenaUsed; // bytes used by the stored payloads (can be less than arenaTop after an eviction)
+    uint32_t tick;
+    uint32_t generation; // incremented each time payloads are written or moved in the arena (update or compaction)
+};
+
 
 typedef struct mqttClient mqttClient;
 
@@ -80,6 +128,9 @@ struct mqttClient{
     int brokerPort; // required (must be set by the user)
     char* userName; // optional (Null mean this variable not in use)
     char* password; // optional (Null mean this variable not in use)
+
+    //****** last value cache ******//
+    mqttCache* cache; // optional (Null mean the cache is not in use)
 };
 
 //**************************************************************************** Fixed header ****************************************************************************//
@@ -245,5 +296,12 @@ int mqtt_client_set_lastTestament(mqttClient *client, char* topic, char* message
 int mqtt_client_connect(mqttClient *client);
 int mqtt_client_connect_adavance(mqttClient *client, bool newSession, uint16_t keepAlive);
 int mqtt_client_publish(mqttClient *client, char *topic, char *message, int Qos);
+// mqtt_client_init() disables the cache so mqtt_client_cache_enable() must be called after it
+int mqtt_client_cache_enable(mqttClient *client, mqttCache *cache);
+int mqtt_client_cache_prepare(mqttClient *client, char *topic);
+int mqtt_client_cache_update(mqttClient *client, char *topic, uint8_t *payload, size_t payloadLen);
+uint32_t mqtt_client_cache_version(mqttClient *client, int handle);
+uint32_t mqtt_client_cache_generation(mqttClient *client);
+const uint8_t* mqtt_client_cache_peek(mqttClient *client, int handle, uint16_t *payloadLen, uint32_t *version);
 
 #endif
\ No newline at end of file
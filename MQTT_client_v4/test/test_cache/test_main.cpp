@@ -0,0 +1,122 @@
+//***************************************************//
+//****** Unit tests of the MQTT last value cache ******//
+//***************************************************//
+
+#include <Arduino.h>
+#include <unity.h>
+#if defined (__cplusplus)
+extern "C"{
+#endif
+  #include <MQTTClient.h>
+#if defined (__cplusplus)
+}
+#endif
+
+mqttClient client;
+mqttCache cache;
+uint8_t payload[MQTT_CACHE_ARENA_SIZE];
+
+void setUp(void) {
+  client.cache = NULL;
+  mqtt_client_cache_enable(&client, &cache);
+}
+
+// store a payload of len bytes all equal to value
+int update(const char *topic, uint8_t value, size_t len) {
+  memset(payload, value, len);
+  return mqtt_client_cache_update(&client, (char*)topic, payload, len);
+}
+
+// check that the handle has a payload of len bytes all equal to value
+void assert_payload(int handle, uint8_t value, uint16_t len) {
+  uint16_t storedLen = 0xFFFF;
+  const uint8_t *stored = mqtt_client_cache_peek(&client, handle, &storedLen, NULL);
+  TEST_ASSERT_NOT_NULL(stored);
+  TEST_ASSERT_EQUAL(len, storedLen);
+  for(int i=0; i<len; i++){
+    TEST_ASSERT_EQUAL(value, stored[i]);
+  }
+}
+
+// a zero length payload (used to clear a retained message) must not block the compaction of the arena, and the moved payloads must keep their bytes
+void test_compact_with_empty_payload(void) {
+  int t1 = mqtt_client_cache_prepare(&client, (char*)"T1");
+  int t2 = mqtt_client_cache_prepare(&client, (char*)"T2");
+  int t3 = mqtt_client_cache_prepare(&client, (char*)"T3");
+  TEST_ASSERT_EQUAL(t1, update("T1", 'a', 0));
+  TEST_ASSERT_EQUAL(t2, update("T2", 'b', 500));
+  TEST_ASSERT_EQUAL(t3, update("T3", 'c', 400));
+  uint32_t generation = mqtt_client_cache_generation(&client);
+  // the arena is full at its end so this update has to compact it, T3 is moved to the beginning
+  TEST_ASSERT_EQUAL(t2, update("T2", 'd', 200));
+  TEST_ASSERT_TRUE(mqtt_client_cache_generation(&client) != generation);
+
+  assert_payload(t1, 'a', 0);
+  assert_payload(t2, 'd', 200);
+  assert_payload(t3, 'c', 400);
+  // moving a payload doesn't change its value
+  TEST_ASSERT_EQUAL(1, mqtt_client_cache_version(&client, t3));
+}
+
+// the least recently used payload is evicted, a payload read with peek is used
+void test_evict_least_recently_used(void) {
+  int t1 = mqtt_client_cache_prepare(&client, (char*)"T1");
+  int t2 = mqtt_client_cache_prepare(&client, (char*)"T2");
+  int t3 = mqtt_client_cache_prepare(&client, (char*)"T3");
+  update("T1", 'a', 400);
+  update("T2", 'b', 400);
+  assert_payload(t1, 'a', 400);
+  update("T3", 'c', 400);
+
+  uint16_t len = 0xFFFF;
+  uint32_t version = 0;
+  TEST_ASSERT_NULL(mqtt_client_cache_peek(&client, t2, &len, &version));
+  TEST_ASSERT_EQUAL(0, len);
+  // the eviction is a change of the value
+  TEST_ASSERT_EQUAL(2, version);
+  TEST_ASSERT_EQUAL(2, mqtt_client_cache_version(&client, t2));
+  assert_payload(t1, 'a', 400);
+  assert_payload(t3, 'c', 400);
+}
+
+// the version is incremented on each update
+void test_version_incremented_on_update(void) {
+  int t1 = mqtt_client_cache_prepare(&client, (char*)"T1");
+  TEST_ASSERT_EQUAL(0, mqtt_client_cache_version(&client, t1));
+  for(uint32_t i=1; i<=3; i++){
+    update("T1", 'a' + i, 8);
+    TEST_ASSERT_EQUAL(i, mqtt_client_cache_version(&client, t1));
+    assert_payload(t1, 'a' + i, 8);
+  }
+}
+
+// only the prepared topics are stored
+void test_update_ignores_unprepared_topic(void) {
+  TEST_ASSERT_EQUAL(-1, update("not/prepared", 'a', 4));
+  for(int i=0; i<MQTT_CACHE_SLOTS; i++){
+    char topic[16];
+    sprintf(topic, "topic/%d", i);
+    TEST_ASSERT_TRUE(mqtt_client_cache_prepare(&client, topic) >= 0);
+  }
+}
+
+// a payload bigger than the arena is rejected and not truncated
+void test_update_rejects_big_payload(void) {
+  int t1 = mqtt_client_cache_prepare(&client, (char*)"T1");
+  TEST_ASSERT_EQUAL(-1, mqtt_client_cache_update(&client, (char*)"T1", payload, (size_t)0x10000 + 10));
+  TEST_ASSERT_EQUAL(0, mqtt_client_cache_version(&client, t1));
+}
+
+void setup() {
+  delay(2000);
+  UNITY_BEGIN();
+  RUN_TEST(test_compact_with_empty_payload);
+  RUN_TEST(test_evict_least_recently_used);
+  RUN_TEST(test_version_incremented_on_update);
+  RUN_TEST(test_update_ignores_unprepared_topic);
+  RUN_TEST(test_update_rejects_big_payload);
+  UNITY_END();
+}
+
+void loop() {
+}